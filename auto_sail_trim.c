@@ -1,29 +1,76 @@
 #include "msp430.h" 
+#include "sail_trim_law.h" 
 
 #define SERVO_OUTPUT BIT2 
 #define POSITION_INPUT BIT1 
+#define BOOM_INPUT BIT0 
 #define SMCLK_FREQ 1100000 
 #define SERVO_FREQ 50 
-#define CENTRE_OFFSET 0 
-#define CENTRE 1700 
-#define PORT_RUN_POSITION 1200 
-#define STBD_RUN_POSITION 2200 
-#define WIND_OFFSET 0 
+#define IDLE_SUPPRESS 0 
+#define IDLE_HOLD_FRAMES 50 
+#define IDLE_DEADBAND 8 
+#define IDLE_PULSE_EVERY 0 
+#define ADC_PROFILE_FAST 0 
+#define ADC_PROFILE_BALANCED 1 
+#define ADC_PROFILE_LOW_NOISE 2 
+#define ADC_PROFILE ADC_PROFILE_BALANCED 
+#if ADC_PROFILE == ADC_PROFILE_LOW_NOISE
+#define ADC_AVERAGE_BITS 2 
+#else
+#define ADC_AVERAGE_BITS 0 
+#endif
+#define MEASURE_LATENCY 0 
+#define BOOM_FEEDBACK 0 
+#define VCC_GOVERNOR 0 
+#define VCC_CHECK_FRAMES 250 
+#define VCC_LOW_MV 3000 
+#define VCC_SAFE_MV 2400 
+#define VCC_HYSTERESIS_MV 100 
+#define VCC_SAFE_CHECKS 3 
+#define LOW_UPDATE_FRAMES 4 
+#define NORMAL_FILTER_DEPTH 2 
+#define LOW_FILTER_DEPTH 0 
+#define SAFE_POSITION (CENTRE + CENTRE_OFFSET) 
+#define SAFE_HOLD_FRAMES 50 
+#define SAFE_PULSE_EVERY 10 
+#define VCC_REF_SWITCH 1000 
+#define REF_SETTLE_CYCLES 100 
+#define GOVERNOR_NORMAL 0 
+#define GOVERNOR_LOW 1 
+#define GOVERNOR_SAFE 2 
 
 void disableWatchdog(void);
 void initPWM(void);
 void initADC(void);
 void initClock(void);
-void inIrons(int);
-void setSailPort(int, int, int, float);
 void portRun();
-void setSailStbd(int, int, int, float);
 void stbdRun();
 void samplingAndConversionStart();
 void waitOnBusyADC(void);
-void runAndGybe(int);
-int  calcAppWind(int);
+void waitOnBlockADC(void);
+void convertSensors(void);
+void waitOnFrame(void);
+int  idleSuppress(int);
+int  governVcc(void);
+int  readVcc(void);
+int  filterWind(int);
 
+int idlePulse = 0;
+unsigned int idleFrames = 0;
+int idleStopped = 0;
+unsigned int adcTicks = 0;
+unsigned int latencyTicks = 0;
+volatile unsigned int adcSamples[2];
+int windReading = 0;
+int boomReading = 0;
+int governorLevel = GOVERNOR_NORMAL;
+int vccMillivolts = 0;
+unsigned int vccFrames = VCC_CHECK_FRAMES;
+unsigned int skipFrames = 0;
+unsigned int safeFrames = 0;
+unsigned int safeChecks = 0;
+int windFilter = 0;
+int filterDepth = NORMAL_FILTER_DEPTH;
 
 int main(void) {
     disableWatchdog(); 
@@ -32,65 +79,73 @@ int main(void) {
     initClock();
   
     while(1){ 
-        samplingAndConversionStart();
-        waitOnBusyADC(); 
-       
-        int APPARENT_CENTRE = CENTRE + CENTRE_OFFSET; 
-        int APPARENT_WIND = calcAppWind(ADC10MEM); 
-        
-        if (APPARENT_WIND <= 0x47 || (APPARENT_WIND > 0x3B8 && APPARENT_WIND <= 0x3FF)) {
-            inIrons(APPARENT_CENTRE); 
-        }
-        if (APPARENT_WIND > 0x47 && APPARENT_WIND <= 0x1B8) {
-            float PORT_MULTIPLIER = ((APPARENT_CENTRE - PORT_RUN_POSITION)/(0x1B8 - 0x47));
-            setSailPort(APPARENT_CENTRE, APPARENT_WIND, 0x47, PORT_MULTIPLIER); 
-        }
-        if (APPARENT_WIND > 0x1B8 && APPARENT_WIND <= 0x246) {
-            runAndGybe(APPARENT_WIND); 
+        waitOnFrame();
+#if VCC_GOVERNOR
+        if (governVcc()){
+            continue;
         }
-        if (APPARENT_WIND > 0x246 && APPARENT_WIND <= 0x3B8) {
-            float STBD_MULTIPLIER = ((STBD_RUN_POSITION - APPARENT_CENTRE)/(0x3B8 - 0x246));
-            setSailStbd(APPARENT_CENTRE, APPARENT_WIND, 0x3B8, STBD_MULTIPLIER); 
+#endif
+#if MEASURE_LATENCY
+        unsigned int SAMPLE_START = TA0R;
+#endif
+        convertSensors(); 
+#if MEASURE_LATENCY
+        adcTicks = TA0R - SAMPLE_START;
+#endif
+       
+        int APPARENT_WIND = calcAppWind(windReading); 
+#if VCC_GOVERNOR
+        APPARENT_WIND = filterWind(APPARENT_WIND);
+#endif
+        int PULSE = calcSailPosition(APPARENT_WIND); 
+#if IDLE_SUPPRESS
+        PULSE = idleSuppress(PULSE);
+#elif VCC_GOVERNOR
+        if (governorLevel == GOVERNOR_LOW){
+            PULSE = idleSuppress(PULSE);
         }
+#endif
+#if BOOM_FEEDBACK
+        PULSE = boomControl(PULSE, boomReading, idleStopped); 
+#endif
+        TA0CCR1 = ditherPulse(PULSE); 
+#if MEASURE_LATENCY
+        latencyTicks = TA0R - SAMPLE_START;
+#endif
     }
 }
 
-int calcAppWind(int ADC10MEM){
-    if ((ADC10MEM + WIND_OFFSET) <= 0x3FF && (ADC10MEM + WIND_OFFSET) >= 0){
-        return ADC10MEM + WIND_OFFSET;
-    }
-    else {
-        return (ADC10MEM + WIND_OFFSET) % 0x3FF; 
-    }
-}
-
-void runAndGybe(int APPARENT_WIND){
-    if (APPARENT_WIND > 0x1B8 && APPARENT_WIND <= 0x1E8){
-        TA0CCR1 = PORT_RUN_POSITION;
-    }
-    if (APPARENT_WIND > 0x1E8 && APPARENT_WIND <= 0x217) {
-        float GYBE_MULTIPLIER = ((STBD_RUN_POSITION-PORT_RUN_POSITION)/(0x217-0x1E8));
-        TA0CCR1 = PORT_RUN_POSITION + GYBE_MULTIPLIER*APPARENT_WIND;
-    }
-    if (APPARENT_WIND > 0x217 && APPARENT_WIND <= 0x246){
-        TA0CCR1 = STBD_RUN_POSITION; 
-    }
-}
-
-void inIrons(int APPARENT_CENTRE) {
-    TA0CCR1 = APPARENT_CENTRE; 
+void samplingAndConversionStart(){
+#if BOOM_FEEDBACK
+    ADC10CTL0 &= ~(ENC + ADC10IFG);
+    ADC10SA = (unsigned int)adcSamples;
+#endif
+    ADC10CTL0 |= ENC + ADC10SC;
 }
 
-void setSailPort(int APPARENT_CENTRE, int APPARENT_WIND, int START_WIND, float PORT_MULTIPLIER){
-    TA0CCR1 = APPARENT_CENTRE - PORT_MULTIPLIER*(APPARENT_WIND - START_WIND);
-}
+void convertSensors(){
+    unsigned int FIRST = 0;
+    unsigned int BOOM_SUM = 0;
+    int WIND_SUM = 0;
+    int i;
 
-void setSailStbd(int APPARENT_CENTRE, int APPARENT_WIND, int END_WIND, float STBD_MULTIPLIER){
-    TA0CCR1 = APPARENT_CENTRE + STBD_MULTIPLIER*(END_WIND - APPARENT_WIND);
-}
-
-void samplingAndConversionStart(){
-    ADC10CTL0 |= ENC + ADC10SC;
+    for (i = 0; i < (1 << ADC_AVERAGE_BITS); i++){
+        samplingAndConversionStart();
+#if BOOM_FEEDBACK
+        waitOnBlockADC();
+        unsigned int WIND = adcSamples[0];
+        BOOM_SUM += adcSamples[1];
+#else
+        waitOnBusyADC();
+        unsigned int WIND = ADC10MEM;
+#endif
+        if (i == 0){
+            FIRST = WIND;
+        }
+        WIND_SUM += (int)((WIND - FIRST + 0x200) & 0x3FF) - 0x200;
+    }
+    windReading = (FIRST + ((WIND_SUM + ((1 << ADC_AVERAGE_BITS) >> 1)) >> ADC_AVERAGE_BITS)) & 0x3FF;
+    boomReading = (BOOM_SUM + ((1 << ADC_AVERAGE_BITS) >> 1)) >> ADC_AVERAGE_BITS;
 }
 
 // initialize pwm pulse for servo - based on code from //https://forum.43oh.com/topic/3838-servo-control-with-msp430-g2553/
@@ -109,15 +164,146 @@ void initClock() {
 }
 
 void initADC() {
-    ADC10CTL0 = ADC10SHT_2 + ADC10ON;         
-    ADC10CTL1 = INCH_1;                      
+#if ADC_PROFILE == ADC_PROFILE_FAST
+    ADC10CTL0 = SREF_0 + ADC10SHT_1 + ADC10ON;
+    ADC10CTL1 = INCH_1 + ADC10SSEL_0 + ADC10DIV_0;
+#elif ADC_PROFILE == ADC_PROFILE_LOW_NOISE
+    ADC10CTL0 = SREF_0 + ADC10SHT_2 + ADC10ON;
+    ADC10CTL1 = INCH_1 + ADC10SSEL_0 + ADC10DIV_0;
+#else
+    ADC10CTL0 = SREF_0 + ADC10SHT_2 + ADC10ON;         
+    ADC10CTL1 = INCH_1 + ADC10SSEL_0 + ADC10DIV_0;                      
+#endif
     ADC10AE0 |= POSITION_INPUT;              
+#if BOOM_FEEDBACK
+    ADC10CTL0 |= MSC;
+    ADC10CTL1 |= CONSEQ_1;
+    ADC10DTC1 = 2;
+    ADC10AE0 |= BOOM_INPUT;
+#endif
 }
 
 void waitOnBusyADC(){
     while (ADC10CTL1 &ADC10BUSY);
 }
 
+void waitOnBlockADC(){
+    while (!(ADC10CTL0 & ADC10IFG));
+}
+
+void waitOnFrame(){
+    while (!(TA0CTL & TAIFG));
+    TA0CTL &= ~TAIFG;
+    while (TA0R <= TA0CCR1);
+}
+
+int idleSuppress(int PULSE){
+    if (PULSE > idlePulse + IDLE_DEADBAND*PULSE_SCALE || PULSE + IDLE_DEADBAND*PULSE_SCALE < idlePulse){
+        idlePulse = PULSE;
+        idleFrames = 0;
+        idleStopped = 0;
+        TA0CCTL1 = OUTMOD_7;
+        return PULSE;
+    }
+    if (idleFrames < IDLE_HOLD_FRAMES){
+        idleFrames++;
+        return idlePulse;
+    }
+    idleStopped = 1;
+    if (IDLE_PULSE_EVERY && ++idleFrames >= IDLE_HOLD_FRAMES + IDLE_PULSE_EVERY){
+        idleFrames = IDLE_HOLD_FRAMES;
+        TA0CCTL1 = OUTMOD_7;
+    }
+    else {
+        TA0CCTL1 = OUTMOD_0;
+    }
+    return idlePulse;
+}
+
+int governVcc(){
+    if (++vccFrames >= VCC_CHECK_FRAMES && governorLevel != GOVERNOR_SAFE){
+        vccFrames = 0;
+        vccMillivolts = readVcc();
+        safeChecks = vccMillivolts < VCC_SAFE_MV ? safeChecks + 1 : 0;
+        if (safeChecks >= VCC_SAFE_CHECKS){
+            governorLevel = GOVERNOR_SAFE;
+            safeFrames = 0;
+        }
+        else if (vccMillivolts < VCC_LOW_MV){
+            governorLevel = GOVERNOR_LOW;
+            filterDepth = LOW_FILTER_DEPTH;
+        }
+        else if (vccMillivolts >= VCC_LOW_MV + VCC_HYSTERESIS_MV && governorLevel == GOVERNOR_LOW){
+            governorLevel = GOVERNOR_NORMAL;
+            filterDepth = NORMAL_FILTER_DEPTH;
+            idleStopped = 0;
+            TA0CCTL1 = OUTMOD_7;
+        }
+    }
+    if (governorLevel == GOVERNOR_SAFE){
+        TA0CCR1 = SAFE_POSITION;
+        if (safeFrames < SAFE_HOLD_FRAMES){
+            safeFrames++;
+            TA0CCTL1 = OUTMOD_7;
+        }
+        else if (++safeFrames >= SAFE_HOLD_FRAMES + SAFE_PULSE_EVERY){
+            safeFrames = SAFE_HOLD_FRAMES;
+            TA0CCTL1 = OUTMOD_7;
+        }
+        else {
+            TA0CCTL1 = OUTMOD_0;
+        }
+        return 1;
+    }
+    if (governorLevel == GOVERNOR_LOW && ++skipFrames < LOW_UPDATE_FRAMES){
+        if (idleFrames < IDLE_HOLD_FRAMES){
+            idleFrames++;
+        }
+        return 1;
+    }
+    skipFrames = 0;
+    return 0;
+}
+
+int readVcc(){
+    unsigned int CTL0 = ADC10CTL0;
+    unsigned int CTL1 = ADC10CTL1;
+    unsigned char DTC1 = ADC10DTC1;
+    unsigned int READING;
+    int MILLIVOLTS;
+
+    ADC10CTL0 &= ~ENC;
+    ADC10DTC1 = 0;
+    ADC10CTL0 = SREF_1 + ADC10SHT_3 + REFON + ADC10ON;
+    ADC10CTL1 = INCH_11;
+    __delay_cycles(REF_SETTLE_CYCLES);
+    ADC10CTL0 |= ENC + ADC10SC;
+    waitOnBusyADC();
+    READING = ADC10MEM;
+    MILLIVOLTS = (long)READING*3000/1023;
+
+    if (READING >= VCC_REF_SWITCH){
+        ADC10CTL0 &= ~ENC;
+        ADC10CTL0 |= REF2_5V;
+        __delay_cycles(REF_SETTLE_CYCLES);
+        ADC10CTL0 |= ENC + ADC10SC;
+        waitOnBusyADC();
+        MILLIVOLTS = (long)ADC10MEM*5000/1023;
+    }
+
+    ADC10CTL0 &= ~ENC;
+    ADC10CTL0 = CTL0 & ~ENC;
+    ADC10CTL1 = CTL1;
+    ADC10DTC1 = DTC1;
+    return MILLIVOLTS;
+}
+
+int filterWind(int APPARENT_WIND){
+    int DIFFERENCE = ((APPARENT_WIND << 4) - windFilter + 0x2000) & 0x3FFF;
+    windFilter = (windFilter + ((DIFFERENCE - 0x2000 + ((1 << filterDepth) >> 1)) >> filterDepth)) & 0x3FFF;
+    return ((windFilter + 8) >> 4) & 0x3FF;
+}
+
 void disableWatchdog() {
     WDTCTL = WDTPW | WDTHOLD; 
 }
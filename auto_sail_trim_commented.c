@@ -1,9 +1,13 @@
 // ------------------------- HEADER INFORMATION, DEFITIONS -------------------------
 
+// this file shows the whole program in one place, in the build the sail position and boom control functions and their definitions (CENTRE ... PULSE_DITHER, BOOM_PORT_READING ... BOOM_GAIN_DIV)
+// are in sail_trim_law.c / sail_trim_law.h, so the host side tools (trim_batch.c) use exactly the same calculations as the boat
+
 #include "msp430.h"         // header file for msp430 functionality
 
 #define SERVO_OUTPUT BIT2   // pulse output to servo through pin P1.2
 #define POSITION_INPUT BIT1 // position input from position sensor to pin P1.1
+#define BOOM_INPUT BIT0     // boom angle input from optional boom position sensor to pin P1.0 (BOOM_FEEDBACK)
 
 #define SMCLK_FREQ 1100000  // approximate frequency of msp430 SMCLK (clock)
 #define SERVO_FREQ 50       // approximate frequency for Futaba FP-S148 servo motor
@@ -15,6 +19,52 @@
 
 #define WIND_OFFSET 0       // single point of control over wind offset, can change this value to calibrate any offset in wind direction and sensor reading
 
+#define PULSE_FRAC_BITS 3   // sail position is calculated in 1/8 timer ticks, finer than the servo pulse can be set directly
+#define PULSE_SCALE (1 << PULSE_FRAC_BITS) // number of pulse length units per timer tick
+#define PULSE_DITHER 1      // 1 alternates TA0CCR1 between the two nearest timer ticks so the average pulse length has the fractional value, 0 rounds to the nearest tick
+
+#define IDLE_SUPPRESS 0       // set to 1 to stop servo pulses while the sail position is steady, lets the servo relax instead of holding against the sheet
+#define IDLE_HOLD_FRAMES 50   // number of 20 ms frames the sail position must stay steady before pulses are suppressed (50 = 1 s)
+#define IDLE_DEADBAND 8       // change in pulse length (whole timer ticks) that is treated as sensor jitter rather than a wind shift
+#define IDLE_PULSE_EVERY 0    // 0 stops pulses completely while idle, N sends one refresh pulse every N frames while idle
+
+#define ADC_PROFILE_FAST 0       // shortest conversion, 8 cycle sample time is still long enough for the 10k position sensor
+#define ADC_PROFILE_BALANCED 1   // original ADC settings, 16 cycle sample time
+#define ADC_PROFILE_LOW_NOISE 2  // balanced settings, 4 conversions averaged per frame, halves random noise
+#define ADC_PROFILE ADC_PROFILE_BALANCED // ADC profile used by initADC, conversion times are listed in the README
+#if ADC_PROFILE == ADC_PROFILE_LOW_NOISE
+#define ADC_AVERAGE_BITS 2       // 2^ADC_AVERAGE_BITS conversions are averaged per frame
+#else
+#define ADC_AVERAGE_BITS 0
+#endif
+#define MEASURE_LATENCY 0        // set to 1 to store ADC conversion time and sample to TA0CCR1 time (in timer ticks) in adcTicks and latencyTicks
+
+#define BOOM_FEEDBACK 0          // set to 1 if a boom position sensor is fitted, pulse length is then corrected so the measured boom angle matches the optimal sail position
+#define BOOM_PORT_READING 0x100  // boom sensor reading with the boom at the port run position (pulse = PORT_RUN_POSITION, no sheet load), calibrate for each boat
+#define BOOM_STBD_READING 0x300  // boom sensor reading with the boom at the starboard run position (pulse = STBD_RUN_POSITION, no sheet load), calibrate for each boat
+#define BOOM_KP 8                // proportional gain of boom control, divided by BOOM_GAIN_DIV
+#define BOOM_KI 4                // integral gain of boom control (per 20 ms frame), divided by BOOM_GAIN_DIV
+#define BOOM_GAIN_DIV 16         // divider for the boom control gains, keeps the calculation in integers
+#define BOOM_STEADY 8            // the integral only changes while the boom error moves less than this (whole timer ticks) between frames, covers +-2 LSB sensor noise (1 LSB is about 2 ticks)
+
+#define VCC_GOVERNOR 0           // set to 1 to slow down control and servo activity as the battery runs down, and park the boom before brown-out
+#define VCC_CHECK_FRAMES 250     // number of frames between supply voltage measurements (250 = 5 s)
+#define VCC_LOW_MV 3000          // below this supply voltage (mV) the governor switches to low power operation
+#define VCC_SAFE_MV 2400         // below this supply voltage (mV) the boom is parked at SAFE_POSITION until the battery is changed
+#define VCC_REF_SWITCH 1000      // VCC/2 reading with the 1.5 V reference (about 2.93 V) above which readVcc measures again with the 2.5 V reference
+#define REF_SETTLE_CYCLES 100    // MCLK cycles to wait for the reference to settle (30 us max), 67 us at the 1.5 MHz top of the uncalibrated DCO range
+#define VCC_HYSTERESIS_MV 100    // supply voltage must rise this far above VCC_LOW_MV before normal operation resumes
+#define VCC_SAFE_CHECKS 3        // number of measurements in a row below VCC_SAFE_MV before the boom is parked (3 = 15 s), one dip from servo current isn't enough
+#define LOW_UPDATE_FRAMES 4      // in low power operation the sail position is only updated every LOW_UPDATE_FRAMES frames
+#define NORMAL_FILTER_DEPTH 2    // wind filter depth in normal operation, each update moves the filtered wind 1/2^depth of the way to the new reading
+#define LOW_FILTER_DEPTH 0       // wind filter depth in low power operation, shorter because there are fewer updates
+#define SAFE_POSITION (CENTRE + CENTRE_OFFSET) // pulse length (timer ticks) for the boom position held before brown-out
+#define SAFE_HOLD_FRAMES 50      // number of frames full rate pulses are sent to move the boom to SAFE_POSITION
+#define SAFE_PULSE_EVERY 10      // after SAFE_HOLD_FRAMES one refresh pulse is sent every SAFE_PULSE_EVERY frames so the servo keeps holding the boom, 1 = full rate
+#define GOVERNOR_NORMAL 0        // governor level, normal operation
+#define GOVERNOR_LOW 1           // governor level, low battery
+#define GOVERNOR_SAFE 2          // governor level, battery nearly flat, boom parked
+
 
 // ------------------------- FUNCTION DECLARATIONS ----------------------------
 
@@ -23,15 +73,48 @@ void disableWatchdog(void);
 void initPWM(void);
 void initADC(void);
 void initClock(void);
-void inIrons(int);
-void setSailPort(int, int, int, float);
+int  inIrons(int);
+int  setSailPort(int, int, int, float);
 void portRun();
-void setSailStbd(int, int, int, float);
+int  setSailStbd(int, int, int, float);
 void stbdRun();
 void samplingAndConversionStart();
+void convertSensors(void);
 void waitOnBusyADC(void);
-void runAndGybe(int);
+void waitOnBlockADC(void);
+void waitOnFrame(void);
+int  idleSuppress(int);
+int  boomControl(int, int, int);
+int  governVcc(void);
+int  readVcc(void);
+int  filterWind(int);
+int  runAndGybe(int);
 int  calcAppWind(int);
+int  calcSailPosition(int);
+int  ditherPulse(int);
+
+
+// ------------------------- GLOBAL VARIABLES ----------------------------------
+
+int idlePulse = 0;           // last pulse length (1/PULSE_SCALE ticks) that counted as a change in sail position
+unsigned int idleFrames = 0; // number of frames the sail position has been steady
+int idleStopped = 0;         // 1 while idleSuppress has stopped or thinned out the pulses, boom control integral is frozen
+unsigned int adcTicks = 0;     // timer ticks from start of ADC sampling to end of conversion (MEASURE_LATENCY)
+unsigned int latencyTicks = 0; // timer ticks from start of ADC sampling to TA0CCR1 being updated (MEASURE_LATENCY)
+volatile unsigned int adcSamples[2]; // ADC results copied by the data transfer controller (BOOM_FEEDBACK), [0] = wind sensor A1, [1] = boom sensor A0, volatile because the hardware writes it
+int windReading = 0;           // wind sensor reading for this frame (averaged in ADC_PROFILE_LOW_NOISE)
+int boomReading = 0;           // boom sensor reading for this frame (averaged in ADC_PROFILE_LOW_NOISE)
+long boomIntegral = 0;         // integral term of boom control
+int boomError = 0;             // boom control error in the previous frame
+int ditherError = 0;           // fraction of a timer tick left over from the previous frames, carried into the next pulse
+int governorLevel = GOVERNOR_NORMAL;        // current governor level
+int vccMillivolts = 0;                      // last supply voltage measurement (mV)
+unsigned int vccFrames = VCC_CHECK_FRAMES;  // frames since the last supply voltage measurement, starts full so the first frame measures
+unsigned int skipFrames = 0;                // frames since the last sail position update in low power operation
+unsigned int safeFrames = 0;                // frames the boom has been moving to SAFE_POSITION
+unsigned int safeChecks = 0;                // supply voltage measurements in a row below VCC_SAFE_MV
+int windFilter = 0;                         // filtered apparent wind in 1/16 ADC steps
+int filterDepth = NORMAL_FILTER_DEPTH;      // current wind filter depth
 
 
 // ------------------------- FUNCTIONS -----------------------------------------
@@ -44,32 +127,39 @@ int  calcAppWind(int);
     initClock();       // initiliaze msp430 clock
   
     while(1){ 
-        samplingAndConversionStart(); // start sampling and converting ADC input from position sensor
-        waitOnBusyADC();              // wait if ADC busy sampling/converting
-        
-        int APPARENT_CENTRE = CENTRE + CENTRE_OFFSET; // define apparent centre position for boom using offset 
-        int APPARENT_WIND = calcAppWind(ADC10MEM);    // define apparent wind position 
-
-        // optimal angle between wind and sail varies depending on wind position relative to boat, but is consistent within each of the following ranges of wind position 
-        
-        // apparent wind between 0-0x47 or 3B8-0x3FF, corresponds to wind between 335-360, 0-25 degrees, boat can't sail with the wind this close
-        if (APPARENT_WIND <= 0x47 || (APPARENT_WIND > 0x3B8 && APPARENT_WIND <= 0x3FF)) {
-            inIrons(APPARENT_CENTRE); // position sail for being "in irons"
-        }
-        // apparent wind between 0x47 - 0x1B8, corresponds to wind between 205-335 degrees, boat is on a "port tack" and optimal sail position is determined by the PORT_MULTIPLIER
-        if (APPARENT_WIND > 0x47 && APPARENT_WIND <= 0x1B8) {
-            float PORT_MULTIPLIER = ((APPARENT_CENTRE - PORT_RUN_POSITION)/(0x1B8 - 0x47));
-            setSailPort(APPARENT_CENTRE, APPARENT_WIND, 0x47, PORT_MULTIPLIER);
+        waitOnFrame();                // wait for the next frame and the end of its servo pulse, loop runs once per 20 ms frame
+#if VCC_GOVERNOR
+        if (governVcc()){             // check supply voltage, skip this frame if the governor is saving power or has parked the boom
+            continue;
         }
-        // apparent wind between 0x1B8-0x246, corresponds to wind between 155-205 degrees, boat is sailing "downwind" and will either be on a "run" or will "gybe"
-        if (APPARENT_WIND > 0x1B8 && APPARENT_WIND <= 0x246) {
-            runAndGybe(APPARENT_WIND);
-        }
-        // apparent wind between 0x246-0x3B8, corresponds to wind between 25-155 degrees, boat is on a "starboard (stbd) tack"
-        if (APPARENT_WIND > 0x246 && APPARENT_WIND <= 0x3B8) {
-            float STBD_MULTIPLIER = ((STBD_RUN_POSITION - APPARENT_CENTRE)/(0x3B8 - 0x246));
-            setSailStbd(APPARENT_CENTRE, APPARENT_WIND, 0x3B8, STBD_MULTIPLIER); 
+#endif
+#if MEASURE_LATENCY
+        unsigned int SAMPLE_START = TA0R; // timer count when sampling starts
+#endif
+        convertSensors();             // sample and convert ADC input from position sensor(s)
+#if MEASURE_LATENCY
+        adcTicks = TA0R - SAMPLE_START; // ADC conversion time
+#endif
+        
+        int APPARENT_WIND = calcAppWind(windReading);   // define apparent wind position 
+#if VCC_GOVERNOR
+        APPARENT_WIND = filterWind(APPARENT_WIND);      // smooth the wind reading, depth set by the governor
+#endif
+        int PULSE = calcSailPosition(APPARENT_WIND);  // pulse length for the optimal sail position, in 1/PULSE_SCALE timer ticks
+#if IDLE_SUPPRESS
+        PULSE = idleSuppress(PULSE); // stop or thin out pulses if the sail position has been steady
+#elif VCC_GOVERNOR
+        if (governorLevel == GOVERNOR_LOW){
+            PULSE = idleSuppress(PULSE); // low battery, stop pulses while the sail position is steady even if IDLE_SUPPRESS is off
         }
+#endif
+#if BOOM_FEEDBACK
+        PULSE = boomControl(PULSE, boomReading, idleStopped); // pulse length so the measured boom angle reaches the sail position, integral frozen while pulses are stopped
+#endif
+        TA0CCR1 = ditherPulse(PULSE);   // set whole timer ticks for this frame
+#if MEASURE_LATENCY
+        latencyTicks = TA0R - SAMPLE_START; // time from sampling to the new pulse length being set
+#endif
     }
 }
 
@@ -85,43 +175,115 @@ int calcAppWind(int ADC10MEM){
     }
 }
 
+// calculate the pulse length for the optimal sail position from the apparent wind direction
+// all sail position functions return the pulse length in 1/PULSE_SCALE timer ticks, the multipliers are calculated as floats so the slopes aren't truncated
+int calcSailPosition(int APPARENT_WIND){
+    int APPARENT_CENTRE = CENTRE + CENTRE_OFFSET; // define apparent centre position for boom using offset 
+
+    // optimal angle between wind and sail varies depending on wind position relative to boat, but is consistent within each of the following ranges of wind position 
+    
+    // apparent wind between 0-0x47 or 3B8-0x3FF, corresponds to wind between 335-360, 0-25 degrees, boat can't sail with the wind this close
+    if (APPARENT_WIND <= 0x47 || (APPARENT_WIND > 0x3B8 && APPARENT_WIND <= 0x3FF)) {
+        return inIrons(APPARENT_CENTRE); // position sail for being "in irons"
+    }
+    // apparent wind between 0x47 - 0x1B8, corresponds to wind between 205-335 degrees, boat is on a "port tack" and optimal sail position is determined by the PORT_MULTIPLIER
+    if (APPARENT_WIND > 0x47 && APPARENT_WIND <= 0x1B8) {
+        float PORT_MULTIPLIER = ((float)(APPARENT_CENTRE - PORT_RUN_POSITION)*PULSE_SCALE/(0x1B8 - 0x47));
+        return setSailPort(APPARENT_CENTRE, APPARENT_WIND, 0x47, PORT_MULTIPLIER);
+    }
+    // apparent wind between 0x1B8-0x246, corresponds to wind between 155-205 degrees, boat is sailing "downwind" and will either be on a "run" or will "gybe"
+    if (APPARENT_WIND > 0x1B8 && APPARENT_WIND <= 0x246) {
+        return runAndGybe(APPARENT_WIND);
+    }
+    // apparent wind between 0x246-0x3B8, corresponds to wind between 25-155 degrees, boat is on a "starboard (stbd) tack"
+    if (APPARENT_WIND > 0x246 && APPARENT_WIND <= 0x3B8) {
+        float STBD_MULTIPLIER = ((float)(STBD_RUN_POSITION - APPARENT_CENTRE)*PULSE_SCALE/(0x3B8 - 0x246));
+        return setSailStbd(APPARENT_CENTRE, APPARENT_WIND, 0x3B8, STBD_MULTIPLIER); 
+    }
+    // apparent wind outside the ADC range (only possible with a negative WIND_OFFSET), position sail in centre of boat
+    return APPARENT_CENTRE*PULSE_SCALE;
+}
+
 // boat is on a downwind course, will either be on a port run, starboard run, or gybe
-void runAndGybe(int APPARENT_WIND){
+int runAndGybe(int APPARENT_WIND){
     // apparent wind is between 0x1B8-0x1E8, or 188-205 degrees, position sail in the port run position
     if (APPARENT_WIND > 0x1B8 && APPARENT_WIND <= 0x1E8){
-        TA0CCR1 = PORT_RUN_POSITION;
+        return PORT_RUN_POSITION*PULSE_SCALE;
     }
      // apparent wind is between 0x1E8-0x217, or 172-188 degrees, this is the range where the boat will "gybe", and the sail will go from one run position to the other
     if (APPARENT_WIND > 0x1E8 && APPARENT_WIND <= 0x217) {
-        float GYBE_MULTIPLIER = ((STBD_RUN_POSITION-PORT_RUN_POSITION)/(0x217-0x1E8));
-        TA0CCR1 = PORT_RUN_POSITION + GYBE_MULTIPLIER*APPARENT_WIND;
+        float GYBE_MULTIPLIER = ((float)(STBD_RUN_POSITION-PORT_RUN_POSITION)*PULSE_SCALE/(0x217-0x1E8));
+        return PORT_RUN_POSITION*PULSE_SCALE + GYBE_MULTIPLIER*(APPARENT_WIND - 0x1E8) + 0.5f; // + 0.5 rounds to the nearest unit
     }
     // apparent wind is between 0x217-0x246, or 155-172 degrees, position sail in the starboard run position
-    if (APPARENT_WIND > 0x217 && APPARENT_WIND <= 0x246){
-        TA0CCR1 = STBD_RUN_POSITION; 
-    }
+    return STBD_RUN_POSITION*PULSE_SCALE; 
 }
 
 // boat is "in irons" where the wind is too close to centre to sail, position sail in centre of boat
-void inIrons(int APPARENT_CENTRE){
-    TA0CCR1 = APPARENT_CENTRE; 
+int inIrons(int APPARENT_CENTRE){
+    return APPARENT_CENTRE*PULSE_SCALE; 
 }
 
 // boat is on a port tack, sail is positioned according the apparent wind and the multiplier so it ranges from the centre position to the port run position
-void setSailPort(int APPARENT_CENTRE, int APPARENT_WIND, int START_WIND, float PORT_MULTIPLIER){
-    TA0CCR1 = APPARENT_CENTRE - PORT_MULTIPLIER*(APPARENT_WIND - START_WIND);
+int setSailPort(int APPARENT_CENTRE, int APPARENT_WIND, int START_WIND, float PORT_MULTIPLIER){
+    return APPARENT_CENTRE*PULSE_SCALE - PORT_MULTIPLIER*(APPARENT_WIND - START_WIND) + 0.5f;
 }
 
 // boat is on a starboard tack, sail is positioned according the apparent wind and the multiplier so it ranges from the centre position to the starboard run position
-void setSailStbd(int APPARENT_CENTRE, int APPARENT_WIND, int END_WIND, float STBD_MULTIPLIER){
-    TA0CCR1 = APPARENT_CENTRE + STBD_MULTIPLIER*(END_WIND - APPARENT_WIND);
+int setSailStbd(int APPARENT_CENTRE, int APPARENT_WIND, int END_WIND, float STBD_MULTIPLIER){
+    return APPARENT_CENTRE*PULSE_SCALE + STBD_MULTIPLIER*(END_WIND - APPARENT_WIND) + 0.5f;
+}
+
+// convert the pulse length in 1/PULSE_SCALE ticks to whole timer ticks for TA0CCR1
+// sigma-delta dither, the rounding error is carried into the next frame so TA0CCR1 alternates between the two nearest ticks and the average over several frames has the fractional value
+int ditherPulse(int PULSE){
+#if PULSE_DITHER
+    int TOTAL = PULSE + ditherError;
+    int TICKS = (TOTAL + PULSE_SCALE/2) >> PULSE_FRAC_BITS; // round to the nearest tick
+    ditherError = TOTAL - (TICKS << PULSE_FRAC_BITS);       // error left over, between -1/2 and +1/2 tick
+    return TICKS;
+#else
+    return (PULSE + PULSE_SCALE/2) >> PULSE_FRAC_BITS;
+#endif
 }
 
 // sample ADC (analog to digital conversion, input from position sensor)
 void samplingAndConversionStart(){
+#if BOOM_FEEDBACK
+    ADC10CTL0 &= ~(ENC + ADC10IFG);      // ADC must be disabled to restart the data transfer controller, clear the block complete flag
+    ADC10SA = (unsigned int)adcSamples;  // results of the A1, A0 sequence are copied to adcSamples
+#endif
     ADC10CTL0 |= ENC + ADC10SC;
 }
 
+// sample and convert the sensors 2^ADC_AVERAGE_BITS times and average the results into windReading and boomReading
+void convertSensors(){
+    unsigned int FIRST = 0;
+    unsigned int BOOM_SUM = 0;
+    int WIND_SUM = 0;
+    int i;
+
+    for (i = 0; i < (1 << ADC_AVERAGE_BITS); i++){
+        samplingAndConversionStart(); // start sampling and converting ADC input from position sensor(s)
+#if BOOM_FEEDBACK
+        waitOnBlockADC();             // wait until the data transfer controller has copied both results
+        unsigned int WIND = adcSamples[0];
+        BOOM_SUM += adcSamples[1];
+#else
+        waitOnBusyADC();              // wait if ADC busy sampling/converting
+        unsigned int WIND = ADC10MEM;
+#endif
+        // the wind direction wraps around at 0x3FF, so average the differences from the first reading (-0x200 to 0x1FF)
+        // otherwise readings of 0x3FF and 0x000 would average to 0x200 (downwind)
+        if (i == 0){
+            FIRST = WIND;
+        }
+        WIND_SUM += (int)((WIND - FIRST + 0x200) & 0x3FF) - 0x200;
+    }
+    windReading = (FIRST + ((WIND_SUM + ((1 << ADC_AVERAGE_BITS) >> 1)) >> ADC_AVERAGE_BITS)) & 0x3FF; // rounded average
+    boomReading = (BOOM_SUM + ((1 << ADC_AVERAGE_BITS) >> 1)) >> ADC_AVERAGE_BITS;
+}
+
 // initialize PWM pulse for servo - based on code from //https://forum.43oh.com/topic/3838-servo-control-with-msp430-g2553/
 // functionality described in TI MSP430 data sheet
 void initPWM() {
@@ -141,10 +303,25 @@ void initClock() {
 
 // initializa ADC 
 // functionality described in TI MSP430 data sheet
+// all profiles use VCC/VSS as reference (SREF_0), the position sensor is a potentiometer across VCC so the reading doesn't change with battery voltage
 void initADC() {
-    ADC10CTL0 = ADC10SHT_2 + ADC10ON;         // ADC10ON
-    ADC10CTL1 = INCH_1;                       // set input A1
+#if ADC_PROFILE == ADC_PROFILE_FAST
+    ADC10CTL0 = SREF_0 + ADC10SHT_1 + ADC10ON;                // 8 x ADC10CLK sample time, ADC10ON
+    ADC10CTL1 = INCH_1 + ADC10SSEL_0 + ADC10DIV_0;            // set input A1, internal ADC10OSC clock, not divided
+#elif ADC_PROFILE == ADC_PROFILE_LOW_NOISE
+    ADC10CTL0 = SREF_0 + ADC10SHT_2 + ADC10ON;                // 16 x ADC10CLK sample time (settling is already met), ADC10ON
+    ADC10CTL1 = INCH_1 + ADC10SSEL_0 + ADC10DIV_0;            // set input A1, internal ADC10OSC clock, not divided, noise is reduced by averaging in convertSensors
+#else
+    ADC10CTL0 = SREF_0 + ADC10SHT_2 + ADC10ON;                // 16 x ADC10CLK sample time, ADC10ON
+    ADC10CTL1 = INCH_1 + ADC10SSEL_0 + ADC10DIV_0;            // set input A1, internal ADC10OSC clock, not divided
+#endif
     ADC10AE0 |= POSITION_INPUT;               // PA.1 ADC option select
+#if BOOM_FEEDBACK
+    ADC10CTL0 |= MSC;                         // convert the whole sequence after one start
+    ADC10CTL1 |= CONSEQ_1;                    // sequence of channels, from A1 (INCH_1) down to A0
+    ADC10DTC1 = 2;                            // two results per sequence copied to adcSamples
+    ADC10AE0 |= BOOM_INPUT;                   // PA.0 ADC option select
+#endif
 }
 
 // wait on busy ADC (busy sampling/converting)
@@ -152,6 +329,187 @@ void waitOnBusyADC(){
     while (ADC10CTL1 &ADC10BUSY);
 }
 
+// wait for the data transfer controller to finish the block (BOOM_FEEDBACK), ADC10BUSY clears after the last conversion
+// but the last result may not be in adcSamples yet, ADC10IFG is only set once the whole block has been copied
+void waitOnBlockADC(){
+    while (!(ADC10CTL0 & ADC10IFG));
+}
+
+// wait for the start of the next frame (timer rolls over from TA0CCR0 to 0) and then for the end of its servo pulse (timer passes TA0CCR1)
+// TA0CCR1 and TA0CCTL1 can then be changed without cutting a pulse short, and because the wait starts at the frame rollover
+// the loop runs exactly once per frame even if the new TA0CCR1 is above the current timer count
+void waitOnFrame(){
+    while (!(TA0CTL & TAIFG));
+    TA0CTL &= ~TAIFG;
+    while (TA0R <= TA0CCR1);
+}
+
+// idle pulse suppression, an analogue servo only drives its motor while it receives pulses, so stopping them while the sail is steady saves holding current
+// takes and returns the pulse length in 1/PULSE_SCALE ticks
+int idleSuppress(int PULSE){
+    // sail position changed by more than the deadband (wind shift), restart full rate pulses from the next frame
+    if (PULSE > idlePulse + IDLE_DEADBAND*PULSE_SCALE || PULSE + IDLE_DEADBAND*PULSE_SCALE < idlePulse){
+        idlePulse = PULSE;
+        idleFrames = 0;
+        idleStopped = 0;
+        TA0CCTL1 = OUTMOD_7;
+        return PULSE;
+    }
+    // change is within the deadband, keep the previous position so jitter doesn't move the servo
+    // keep sending pulses until the position has been steady for IDLE_HOLD_FRAMES
+    if (idleFrames < IDLE_HOLD_FRAMES){
+        idleFrames++;
+        return idlePulse;
+    }
+    // position is steady, send one refresh pulse every IDLE_PULSE_EVERY frames, otherwise hold the output low (OUTMOD_0)
+    idleStopped = 1;
+    if (IDLE_PULSE_EVERY && ++idleFrames >= IDLE_HOLD_FRAMES + IDLE_PULSE_EVERY){
+        idleFrames = IDLE_HOLD_FRAMES;
+        TA0CCTL1 = OUTMOD_7;
+    }
+    else {
+        TA0CCTL1 = OUTMOD_0;
+    }
+    return idlePulse;
+}
+
+// boom position control, the servo sags under sheet load so the pulse length is corrected until the measured boom angle matches the target pulse length
+// integer PI control, runs once per frame, pulse lengths are in 1/PULSE_SCALE ticks
+// the target comes after idleSuppress so it only moves by more than the deadband, HOLD = 1 freezes the integral while the pulses are stopped
+// (the servo isn't driven then, so the error can't be corrected and the integral would wind up)
+int boomControl(int TARGET, int BOOM_READING, int HOLD){
+    // convert the boom sensor reading to the pulse length that puts the boom at that angle without load, using the two calibration readings
+    int MEASURED = PORT_RUN_POSITION*PULSE_SCALE + (long)(BOOM_READING - BOOM_PORT_READING)*(STBD_RUN_POSITION - PORT_RUN_POSITION)*PULSE_SCALE/(BOOM_STBD_READING - BOOM_PORT_READING);
+    int BOOM_ERROR = TARGET - MEASURED;
+    // only integrate once the error has settled, the remaining error is then the servo sag under load
+    // while the servo is still moving (or just after the target changed) the error is mostly servo lag, integrating it causes overshoot
+    int STEADY = BOOM_ERROR - boomError <= BOOM_STEADY*PULSE_SCALE && boomError - BOOM_ERROR <= BOOM_STEADY*PULSE_SCALE;
+    long INTEGRAL = HOLD || !STEADY ? boomIntegral : boomIntegral + BOOM_KI*(long)BOOM_ERROR;
+    // the error is only remembered while the servo is driven, otherwise the boom sagging out during a hold would look steady
+    // and the first frame after the hold would integrate the whole sag
+    if (!HOLD){
+        boomError = BOOM_ERROR;
+    }
+    long COMMAND = TARGET + (BOOM_KP*(long)BOOM_ERROR + INTEGRAL)/BOOM_GAIN_DIV;
+
+    // anti-windup, the pulse length is limited to the run positions and the integral only changes if it moves the pulse length back inside the limits
+    if (COMMAND < PORT_RUN_POSITION*PULSE_SCALE){
+        if (BOOM_ERROR > 0){
+            boomIntegral = INTEGRAL;
+        }
+        return PORT_RUN_POSITION*PULSE_SCALE;
+    }
+    if (COMMAND > STBD_RUN_POSITION*PULSE_SCALE){
+        if (BOOM_ERROR < 0){
+            boomIntegral = INTEGRAL;
+        }
+        return STBD_RUN_POSITION*PULSE_SCALE;
+    }
+    boomIntegral = INTEGRAL;
+    return COMMAND;
+}
+
+// supply voltage governor, measures VCC every VCC_CHECK_FRAMES frames and sets the governor level
+// returns 1 if the rest of the frame should be skipped (no sampling or sail position update)
+int governVcc(){
+    // the safe level is kept until reset, the battery voltage recovers when the servo stops so it would otherwise switch back and forth
+    if (++vccFrames >= VCC_CHECK_FRAMES && governorLevel != GOVERNOR_SAFE){
+        vccFrames = 0;
+        vccMillivolts = readVcc();
+        // the measurement is taken just after the servo pulse, when servo current can pull the battery down for a moment
+        // so only park the boom after VCC_SAFE_CHECKS low measurements in a row, until then a low measurement counts as low battery
+        safeChecks = vccMillivolts < VCC_SAFE_MV ? safeChecks + 1 : 0;
+        if (safeChecks >= VCC_SAFE_CHECKS){
+            governorLevel = GOVERNOR_SAFE;
+            safeFrames = 0;
+        }
+        else if (vccMillivolts < VCC_LOW_MV){
+            governorLevel = GOVERNOR_LOW;
+            filterDepth = LOW_FILTER_DEPTH;
+        }
+        // battery recovered (e.g. warmed up), return to normal operation and restart pulses that idleSuppress may have stopped
+        else if (vccMillivolts >= VCC_LOW_MV + VCC_HYSTERESIS_MV && governorLevel == GOVERNOR_LOW){
+            governorLevel = GOVERNOR_NORMAL;
+            filterDepth = NORMAL_FILTER_DEPTH;
+            idleStopped = 0;
+            TA0CCTL1 = OUTMOD_7;
+        }
+    }
+    // battery nearly flat, move the boom to the safe position then thin out the pulses so the servo draws less current
+    // without pulses the servo would go limp and the sheet could pull the boom anywhere, so refresh pulses keep it holding SAFE_POSITION
+    if (governorLevel == GOVERNOR_SAFE){
+        TA0CCR1 = SAFE_POSITION;
+        if (safeFrames < SAFE_HOLD_FRAMES){
+            safeFrames++;
+            TA0CCTL1 = OUTMOD_7;
+        }
+        else if (++safeFrames >= SAFE_HOLD_FRAMES + SAFE_PULSE_EVERY){
+            safeFrames = SAFE_HOLD_FRAMES;
+            TA0CCTL1 = OUTMOD_7;
+        }
+        else {
+            TA0CCTL1 = OUTMOD_0;
+        }
+        return 1;
+    }
+    // low battery, only update the sail position every LOW_UPDATE_FRAMES frames
+    // skipped frames still count towards the idle hold time, so the pulses stop after IDLE_HOLD_FRAMES frames and not IDLE_HOLD_FRAMES updates
+    if (governorLevel == GOVERNOR_LOW && ++skipFrames < LOW_UPDATE_FRAMES){
+        if (idleFrames < IDLE_HOLD_FRAMES){
+            idleFrames++;
+        }
+        return 1;
+    }
+    skipFrames = 0;
+    return 0;
+}
+
+// measure supply voltage (mV) with the internal VCC/2 input (A11)
+// the 1.5 V reference works down to VCC = 2.2 V but only measures up to VCC = 3.0 V, the 2.5 V reference needs VCC >= 2.8 V (datasheet, check against the current revision)
+// so the 1.5 V reference is used first, and the 2.5 V reference only when the reading is close to full scale (VCC above about 2.93 V)
+// the wind sensor settings are saved and restored, this runs between wind conversions so the wind reading isn't affected
+int readVcc(){
+    unsigned int CTL0 = ADC10CTL0;
+    unsigned int CTL1 = ADC10CTL1;
+    unsigned char DTC1 = ADC10DTC1;
+    unsigned int READING;
+    int MILLIVOLTS;
+
+    ADC10CTL0 &= ~ENC;                                            // ADC must be disabled to change settings
+    ADC10DTC1 = 0;                                                // don't copy this result to adcSamples (BOOM_FEEDBACK)
+    ADC10CTL0 = SREF_1 + ADC10SHT_3 + REFON + ADC10ON;            // internal 1.5 V reference, 64 x ADC10CLK sample time
+    ADC10CTL1 = INCH_11;                                          // set input A11, VCC/2
+    __delay_cycles(REF_SETTLE_CYCLES);                            // wait for the reference to settle, long enough for any uncalibrated DCO frequency
+    ADC10CTL0 |= ENC + ADC10SC;
+    waitOnBusyADC();
+    READING = ADC10MEM;
+    MILLIVOLTS = (long)READING*3000/1023;                         // VCC = 2 x READING x 1.5 V / 1023
+
+    // reading near full scale, VCC may be above 3.0 V, measure again with the 2.5 V reference (VCC is high enough for it now)
+    if (READING >= VCC_REF_SWITCH){
+        ADC10CTL0 &= ~ENC;
+        ADC10CTL0 |= REF2_5V;                                     // internal 2.5 V reference
+        __delay_cycles(REF_SETTLE_CYCLES);                        // the reference settles again after changing voltage
+        ADC10CTL0 |= ENC + ADC10SC;
+        waitOnBusyADC();
+        MILLIVOLTS = (long)ADC10MEM*5000/1023;                    // VCC = 2 x READING x 2.5 V / 1023
+    }
+
+    ADC10CTL0 &= ~ENC;
+    ADC10CTL0 = CTL0 & ~ENC;                                      // restore wind sensor settings, reference is turned off again
+    ADC10CTL1 = CTL1;
+    ADC10DTC1 = DTC1;
+    return MILLIVOLTS;
+}
+
+// filter the apparent wind, the wind direction wraps around at 0x3FF so the filter works on the shortest difference between the reading and the filtered wind
+// the filtered wind is kept in 1/16 ADC steps so small changes aren't lost
+int filterWind(int APPARENT_WIND){
+    int DIFFERENCE = ((APPARENT_WIND << 4) - windFilter + 0x2000) & 0x3FFF;                                         // difference wrapped to -0x2000 to 0x1FFF (+ 0x2000)
+    windFilter = (windFilter + ((DIFFERENCE - 0x2000 + ((1 << filterDepth) >> 1)) >> filterDepth)) & 0x3FFF;   // move 1/2^depth of the way, rounded
+    return ((windFilter + 8) >> 4) & 0x3FF;
+}
+
 // disable watchdog timer
 void disableWatchdog() {
     WDTCTL = WDTPW | WDTHOLD; 
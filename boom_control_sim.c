@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "sail_trim_law.h"
+
+#define SAG_TICKS 120
+#define SERVO_LAG 0.5
+#define SETTLE_FRAMES 100
+#define AVERAGE_FRAMES 20
+#define TOLERANCE_TICKS 3
+#define NOISE_LSB 2
+#define NOISE_SEEDS 20
+#define TICKS_PER_LSB ((double)(STBD_RUN_POSITION - PORT_RUN_POSITION)/(BOOM_STBD_READING - BOOM_PORT_READING))
+
+static double boom;
+static int noiseLsb;
+static int verbose;
+
+static int runCases(void);
+static int boomSensor(void);
+static void servoFrame(int, int);
+static int settle(const char *, int, int, int);
+
+// simulates boomControl with a servo that sags SAG_TICKS under sheet load and moves SERVO_LAG of the way to its position each frame
+// the boom is measured through the boom sensor calibration, so it's quantised like the real reading (1 LSB is about 2 ticks)
+// the cases run without sensor noise, then with up to 1 .. NOISE_LSB counts of random noise on each reading, for NOISE_SEEDS noise sequences
+// returns 1 if the boom doesn't settle within TOLERANCE_TICKS, overshoots, or the integral changes while HOLD is set
+int main(void) {
+    int FAIL = 0;
+    int SEED;
+
+    for (noiseLsb = 0; noiseLsb <= NOISE_LSB; noiseLsb++){
+        int FAILED_SEEDS = 0;
+        printf("sensor noise +-%d LSB\n", noiseLsb);
+        for (SEED = 1; SEED <= (noiseLsb ? NOISE_SEEDS : 1); SEED++){
+            srand(SEED);
+            verbose = SEED == 1;
+            if (runCases()){
+                FAILED_SEEDS++;
+            }
+        }
+        if (noiseLsb){
+            printf("  %d of %d noise sequences failed\n", FAILED_SEEDS, NOISE_SEEDS);
+        }
+        FAIL |= FAILED_SEEDS != 0;
+    }
+
+    printf(FAIL ? "FAIL\n" : "PASS\n");
+    return FAIL;
+}
+
+// the cases run one after another like a sail, so the controller state carries over from one case to the next
+static int runCases(void){
+    int FAIL = 0;
+    long FROZEN;
+    int f;
+
+    boom = CENTRE + CENTRE_OFFSET - SAG_TICKS;
+    boomIntegral = 0;
+    boomError = 0;
+    ditherError = 0;
+
+    // wind shift from centre to a reach
+    FAIL |= settle("step 1700 -> 1900", 1900*PULSE_SCALE, CENTRE + CENTRE_OFFSET, 0);
+
+    // starboard run, the sagged boom can't reach STBD_RUN_POSITION, the output stays at the limit without winding up
+    FAIL |= settle("step 1900 -> 2200 (limit)", STBD_RUN_POSITION*PULSE_SCALE, 1900, SAG_TICKS);
+    FAIL |= settle("step 2200 -> 1900", 1900*PULSE_SCALE, STBD_RUN_POSITION, 0);
+
+    // idle suppression stops the pulses, the servo isn't driven and the sheet pulls the boom out, the integral must not change
+    FROZEN = boomIntegral;
+    for (f = 0; f < 5*SETTLE_FRAMES; f++){
+        boomControl(1900*PULSE_SCALE, boomSensor(), 1);
+        boom += (1900 - 2*SAG_TICKS - boom)*SERVO_LAG;
+    }
+    if (verbose || boomIntegral != FROZEN){
+        printf("  %-28s integral %ld -> %ld\n", "hold 500 frames", FROZEN, boomIntegral);
+    }
+    if (boomIntegral != FROZEN){
+        FAIL = 1;
+    }
+    FAIL |= settle("pulses restarted at 1900", 1900*PULSE_SCALE, 1900 - 2*SAG_TICKS, 0);
+    return FAIL;
+}
+
+static int boomSensor(void){
+    int NOISE = noiseLsb ? rand() % (2*noiseLsb + 1) - noiseLsb : 0;
+    return BOOM_PORT_READING + (int)((boom - PORT_RUN_POSITION)/TICKS_PER_LSB) + NOISE;
+}
+
+static void servoFrame(int PULSE, int SAG){
+    boom += (ditherPulse(PULSE) - SAG - boom)*SERVO_LAG;
+}
+
+// runs SETTLE_FRAMES frames towards TARGET (1/PULSE_SCALE ticks)
+// the boom averaged over the last AVERAGE_FRAMES frames must be within TOLERANCE_TICKS, so the integral has corrected the sag
+// the boom must not go past the target by more than TOLERANCE_TICKS plus the sensor noise (the loop follows the noise a little)
+// ALLOWED_SHORT is how far short of the target the boom may stop (target beyond what the sagged servo can reach)
+// also reports the share of frames in which the integral changed, if noise stopped the error looking steady this would drop to 0
+static int settle(const char *NAME, int TARGET, int START, int ALLOWED_SHORT){
+    double GOAL = (double)TARGET/PULSE_SCALE;
+    double BAND = TOLERANCE_TICKS + noiseLsb*TICKS_PER_LSB;
+    double OVERSHOOT = 0;
+    double AVERAGE = 0;
+    int SETTLED = 0;
+    int INTEGRATING = 0;
+    int FAIL = 0;
+    int f;
+
+    for (f = 0; f < SETTLE_FRAMES; f++){
+        long INTEGRAL = boomIntegral;
+        servoFrame(boomControl(TARGET, boomSensor(), 0), SAG_TICKS);
+        INTEGRATING += boomIntegral != INTEGRAL;
+        if ((GOAL - START)*(boom - GOAL) > 0 && (boom > GOAL ? boom - GOAL : GOAL - boom) > OVERSHOOT){
+            OVERSHOOT = boom > GOAL ? boom - GOAL : GOAL - boom;
+        }
+        if (boom - GOAL > BAND || GOAL - boom > BAND + ALLOWED_SHORT){
+            SETTLED = f + 1;
+        }
+        if (f >= SETTLE_FRAMES - AVERAGE_FRAMES){
+            AVERAGE += boom/AVERAGE_FRAMES;
+        }
+    }
+    if (OVERSHOOT > BAND){
+        FAIL = 1;
+    }
+    if (AVERAGE - GOAL > TOLERANCE_TICKS || GOAL - AVERAGE > TOLERANCE_TICKS + ALLOWED_SHORT){
+        FAIL = 1;
+    }
+    if (verbose || FAIL){
+        printf("  %-28s boom %7.1f  error %6.1f  overshoot %5.1f  settled %3d frames  integrating %3d%%\n",
+               NAME, AVERAGE, AVERAGE - GOAL, OVERSHOOT, SETTLED, INTEGRATING*100/SETTLE_FRAMES);
+    }
+    return FAIL;
+}
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <math.h>
+#include "sail_trim_law.h" 
+
+#define TICK_US (1e6 / 1100000) 
+
+static double idealPulse(int);
+static int oldPulse(int);
+static double ditheredPulse(int, int);
+
+// compares the pulse length the boat sends with the exact sail position for every port and starboard tack reading
+// old = integer slopes from before the fractional pulse, rounded = PULSE_DITHER 0, dithered = average TA0CCR1 over a number of frames
+int main(void) {
+    const char *NAME[] = {"old", "rounded", "dithered 4 frames", "dithered 8 frames", "dithered 32 frames"};
+    double MAX_ERROR[5] = {0};
+    double SUM_ERROR[5] = {0};
+    int COUNT = 0;
+    int W, k;
+
+    for (W = 0; W <= 0x3FF; W++){
+        double IDEAL;
+        double ERROR[5];
+
+        if (!((W > 0x47 && W <= 0x1B8) || (W > 0x246 && W <= 0x3B8))){
+            continue;
+        }
+        IDEAL = idealPulse(W);
+        ERROR[0] = fabs(oldPulse(W) - IDEAL);
+        ERROR[1] = fabs(((calcSailPosition(W) + PULSE_SCALE/2) >> PULSE_FRAC_BITS) - IDEAL);
+        ERROR[2] = fabs(ditheredPulse(W, 4) - IDEAL);
+        ERROR[3] = fabs(ditheredPulse(W, 8) - IDEAL);
+        ERROR[4] = fabs(ditheredPulse(W, 32) - IDEAL);
+        for (k = 0; k < 5; k++){
+            SUM_ERROR[k] += ERROR[k];
+            if (ERROR[k] > MAX_ERROR[k]){
+                MAX_ERROR[k] = ERROR[k];
+            }
+        }
+        COUNT++;
+    }
+
+    printf("%d tack readings, 1 tick = %.3f us\n", COUNT, TICK_US);
+    printf("%-20s %12s %12s %12s\n", "", "max (ticks)", "mean (ticks)", "max (us)");
+    for (k = 0; k < 5; k++){
+        printf("%-20s %12.3f %12.3f %12.3f\n", NAME[k], MAX_ERROR[k], SUM_ERROR[k] / COUNT, MAX_ERROR[k] * TICK_US);
+    }
+    return 0;
+}
+
+static double idealPulse(int W){
+    double APPARENT_CENTRE = CENTRE + CENTRE_OFFSET;
+    if (W <= 0x1B8){
+        return APPARENT_CENTRE - (APPARENT_CENTRE - PORT_RUN_POSITION)*(W - 0x47)/(0x1B8 - 0x47);
+    }
+    return APPARENT_CENTRE + (STBD_RUN_POSITION - APPARENT_CENTRE)*(0x3B8 - W)/(0x3B8 - 0x246);
+}
+
+static int oldPulse(int W){
+    int APPARENT_CENTRE = CENTRE + CENTRE_OFFSET;
+    if (W <= 0x1B8){
+        float PORT_MULTIPLIER = ((APPARENT_CENTRE - PORT_RUN_POSITION)/(0x1B8 - 0x47));
+        return APPARENT_CENTRE - PORT_MULTIPLIER*(W - 0x47);
+    }
+    float STBD_MULTIPLIER = ((STBD_RUN_POSITION - APPARENT_CENTRE)/(0x3B8 - 0x246));
+    return APPARENT_CENTRE + STBD_MULTIPLIER*(0x3B8 - W);
+}
+
+// worst average over FRAMES frames, for every starting dither error
+static double ditheredPulse(int W, int FRAMES){
+    double IDEAL = idealPulse(W);
+    double WORST = IDEAL;
+    int START, f;
+
+    for (START = -PULSE_SCALE/2; START < PULSE_SCALE/2; START++){
+        long SUM = 0;
+        ditherError = START;
+        for (f = 0; f < FRAMES; f++){
+            SUM += ditherPulse(calcSailPosition(W));
+        }
+        if (fabs((double)SUM / FRAMES - IDEAL) > fabs(WORST - IDEAL)){
+            WORST = (double)SUM / FRAMES;
+        }
+    }
+    return WORST;
+}
@@ -0,0 +1,94 @@
+#include "sail_trim_law.h" 
+
+int ditherError = 0;
+long boomIntegral = 0;
+int boomError = 0;
+
+int calcAppWind(int ADC10MEM){
+    if ((ADC10MEM + WIND_OFFSET) <= 0x3FF && (ADC10MEM + WIND_OFFSET) >= 0){
+        return ADC10MEM + WIND_OFFSET;
+    }
+    else {
+        return (ADC10MEM + WIND_OFFSET) % 0x3FF; 
+    }
+}
+
+int calcSailPosition(int APPARENT_WIND){
+    int APPARENT_CENTRE = CENTRE + CENTRE_OFFSET; 
+
+    if (APPARENT_WIND <= 0x47 || (APPARENT_WIND > 0x3B8 && APPARENT_WIND <= 0x3FF)) {
+        return inIrons(APPARENT_CENTRE); 
+    }
+    if (APPARENT_WIND > 0x47 && APPARENT_WIND <= 0x1B8) {
+        float PORT_MULTIPLIER = ((float)(APPARENT_CENTRE - PORT_RUN_POSITION)*PULSE_SCALE/(0x1B8 - 0x47));
+        return setSailPort(APPARENT_CENTRE, APPARENT_WIND, 0x47, PORT_MULTIPLIER); 
+    }
+    if (APPARENT_WIND > 0x1B8 && APPARENT_WIND <= 0x246) {
+        return runAndGybe(APPARENT_WIND); 
+    }
+    if (APPARENT_WIND > 0x246 && APPARENT_WIND <= 0x3B8) {
+        float STBD_MULTIPLIER = ((float)(STBD_RUN_POSITION - APPARENT_CENTRE)*PULSE_SCALE/(0x3B8 - 0x246));
+        return setSailStbd(APPARENT_CENTRE, APPARENT_WIND, 0x3B8, STBD_MULTIPLIER); 
+    }
+    return APPARENT_CENTRE*PULSE_SCALE;
+}
+
+int runAndGybe(int APPARENT_WIND){
+    if (APPARENT_WIND > 0x1B8 && APPARENT_WIND <= 0x1E8){
+        return PORT_RUN_POSITION*PULSE_SCALE;
+    }
+    if (APPARENT_WIND > 0x1E8 && APPARENT_WIND <= 0x217) {
+        float GYBE_MULTIPLIER = ((float)(STBD_RUN_POSITION-PORT_RUN_POSITION)*PULSE_SCALE/(0x217-0x1E8));
+        return PORT_RUN_POSITION*PULSE_SCALE + GYBE_MULTIPLIER*(APPARENT_WIND - 0x1E8) + 0.5f;
+    }
+    return STBD_RUN_POSITION*PULSE_SCALE; 
+}
+
+int inIrons(int APPARENT_CENTRE) {
+    return APPARENT_CENTRE*PULSE_SCALE; 
+}
+
+int setSailPort(int APPARENT_CENTRE, int APPARENT_WIND, int START_WIND, float PORT_MULTIPLIER){
+    return APPARENT_CENTRE*PULSE_SCALE - PORT_MULTIPLIER*(APPARENT_WIND - START_WIND) + 0.5f;
+}
+
+int setSailStbd(int APPARENT_CENTRE, int APPARENT_WIND, int END_WIND, float STBD_MULTIPLIER){
+    return APPARENT_CENTRE*PULSE_SCALE + STBD_MULTIPLIER*(END_WIND - APPARENT_WIND) + 0.5f;
+}
+
+int ditherPulse(int PULSE){
+#if PULSE_DITHER
+    int TOTAL = PULSE + ditherError;
+    int TICKS = (TOTAL + PULSE_SCALE/2) >> PULSE_FRAC_BITS;
+    ditherError = TOTAL - (TICKS << PULSE_FRAC_BITS);
+    return TICKS;
+#else
+    return (PULSE + PULSE_SCALE/2) >> PULSE_FRAC_BITS;
+#endif
+}
+
+int boomControl(int TARGET, int BOOM_READING, int HOLD){
+    int MEASURED = PORT_RUN_POSITION*PULSE_SCALE + (long)(BOOM_READING - BOOM_PORT_READING)*(STBD_RUN_POSITION - PORT_RUN_POSITION)*PULSE_SCALE/(BOOM_STBD_READING - BOOM_PORT_READING);
+    int BOOM_ERROR = TARGET - MEASURED;
+    int STEADY = BOOM_ERROR - boomError <= BOOM_STEADY*PULSE_SCALE && boomError - BOOM_ERROR <= BOOM_STEADY*PULSE_SCALE;
+    long INTEGRAL = HOLD || !STEADY ? boomIntegral : boomIntegral + BOOM_KI*(long)BOOM_ERROR;
+    if (!HOLD){
+        boomError = BOOM_ERROR;
+    }
+    long COMMAND = TARGET + (BOOM_KP*(long)BOOM_ERROR + INTEGRAL)/BOOM_GAIN_DIV;
+
+    if (COMMAND < PORT_RUN_POSITION*PULSE_SCALE){
+        if (BOOM_ERROR > 0){
+            boomIntegral = INTEGRAL;
+        }
+        return PORT_RUN_POSITION*PULSE_SCALE;
+    }
+    if (COMMAND > STBD_RUN_POSITION*PULSE_SCALE){
+        if (BOOM_ERROR < 0){
+            boomIntegral = INTEGRAL;
+        }
+        return STBD_RUN_POSITION*PULSE_SCALE;
+    }
+    boomIntegral = INTEGRAL;
+    return COMMAND;
+}
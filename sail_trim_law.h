@@ -0,0 +1,32 @@
+#ifndef SAIL_TRIM_LAW_H
+#define SAIL_TRIM_LAW_H
+
+#define CENTRE_OFFSET 0 
+#define CENTRE 1700 
+#define PORT_RUN_POSITION 1200 
+#define STBD_RUN_POSITION 2200 
+#define WIND_OFFSET 0 
+#define PULSE_FRAC_BITS 3 
+#define PULSE_SCALE (1 << PULSE_FRAC_BITS) 
+#define PULSE_DITHER 1 
+#define BOOM_PORT_READING 0x100 
+#define BOOM_STBD_READING 0x300 
+#define BOOM_KP 8 
+#define BOOM_KI 4 
+#define BOOM_GAIN_DIV 16 
+#define BOOM_STEADY 8 
+
+int  calcAppWind(int);
+int  calcSailPosition(int);
+int  inIrons(int);
+int  setSailPort(int, int, int, float);
+int  setSailStbd(int, int, int, float);
+int  runAndGybe(int);
+int  ditherPulse(int);
+int  boomControl(int, int, int);
+
+extern int ditherError;
+extern long boomIntegral;
+extern int boomError;
+
+#endif
@@ -0,0 +1,66 @@
+#include "sail_trim_law.h" 
+#include "trim_batch.h" 
+
+// samples per block, keeps the wind and pulse arrays for a block in L1 cache
+#define TRIM_BLOCK 256 
+
+static void calcAppWindBlock(const int *, int *, int);
+static void calcSailPositionBlock(const int *, int *, int);
+
+void trimBatch(const int *RAW, int *PULSE, long N){
+    int WIND[TRIM_BLOCK];
+    long START;
+
+    for (START = 0; START < N; START += TRIM_BLOCK){
+        int COUNT = (N - START < TRIM_BLOCK) ? (int)(N - START) : TRIM_BLOCK;
+        calcAppWindBlock(RAW + START, WIND, COUNT);
+        calcSailPositionBlock(WIND, PULSE + START, COUNT);
+    }
+}
+
+// the dither error depends on the previous sample, so this pass is sequential, it runs on each block while it is still in L1 cache
+void trimBatchTicks(const int *RAW, int *TICKS, long N){
+    long START;
+    int i;
+
+    for (START = 0; START < N; START += TRIM_BLOCK){
+        int COUNT = (N - START < TRIM_BLOCK) ? (int)(N - START) : TRIM_BLOCK;
+        trimBatch(RAW + START, TICKS + START, COUNT);
+        for (i = 0; i < COUNT; i++){
+            TICKS[START + i] = ditherPulse(TICKS[START + i]);
+        }
+    }
+}
+
+// same as calcAppWind, written as a select so the loop vectorizes
+static void calcAppWindBlock(const int *RAW, int *WIND, int COUNT){
+    int i;
+    for (i = 0; i < COUNT; i++){
+        int W = RAW[i] + WIND_OFFSET;
+        WIND[i] = ((W <= 0x3FF) & (W >= 0)) ? W : W % 0x3FF;
+    }
+}
+
+// same as calcSailPosition, every sail position is calculated and the one for the wind range is selected, no branches in the loop
+// the float expressions must stay the same as sail_trim_law.c so the results match the firmware exactly (trim_batch_bench checks this)
+static void calcSailPositionBlock(const int *WIND, int *PULSE, int COUNT){
+    const int APPARENT_CENTRE = CENTRE + CENTRE_OFFSET;
+    const float PORT_MULTIPLIER = ((float)(APPARENT_CENTRE - PORT_RUN_POSITION)*PULSE_SCALE/(0x1B8 - 0x47));
+    const float STBD_MULTIPLIER = ((float)(STBD_RUN_POSITION - APPARENT_CENTRE)*PULSE_SCALE/(0x3B8 - 0x246));
+    const float GYBE_MULTIPLIER = ((float)(STBD_RUN_POSITION-PORT_RUN_POSITION)*PULSE_SCALE/(0x217-0x1E8));
+    int i;
+
+    for (i = 0; i < COUNT; i++){
+        int W = WIND[i];
+        int PORT = APPARENT_CENTRE*PULSE_SCALE - PORT_MULTIPLIER*(W - 0x47) + 0.5f;
+        int GYBE = PORT_RUN_POSITION*PULSE_SCALE + GYBE_MULTIPLIER*(W - 0x1E8) + 0.5f;
+        int STBD = APPARENT_CENTRE*PULSE_SCALE + STBD_MULTIPLIER*(0x3B8 - W) + 0.5f;
+        int P = APPARENT_CENTRE*PULSE_SCALE;
+        P = ((W > 0x47) & (W <= 0x1B8)) ? PORT : P;
+        P = ((W > 0x1B8) & (W <= 0x1E8)) ? PORT_RUN_POSITION*PULSE_SCALE : P;
+        P = ((W > 0x1E8) & (W <= 0x217)) ? GYBE : P;
+        P = ((W > 0x217) & (W <= 0x246)) ? STBD_RUN_POSITION*PULSE_SCALE : P;
+        P = ((W > 0x246) & (W <= 0x3B8)) ? STBD : P;
+        PULSE[i] = P;
+    }
+}
@@ -0,0 +1,13 @@
+#ifndef TRIM_BATCH_H
+#define TRIM_BATCH_H
+
+// host side batch version of calcAppWind + calcSailPosition, gives the same pulse lengths as the firmware
+// RAW holds ADC readings (0x0-0x3FF), PULSE receives the pulse length from calcSailPosition in 1/PULSE_SCALE timer ticks
+// (the value ditherPulse turns into TA0CCR1 counts on the boat)
+void trimBatch(const int *RAW, int *PULSE, long N);
+
+// trimBatch followed by ditherPulse on each result in order, TICKS receives the TA0CCR1 counts the boat would send for the sequence
+// the dither error carries on from ditherError and is left there for the next call, set ditherError to start from a known state
+void trimBatchTicks(const int *RAW, int *TICKS, long N);
+
+#endif
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "sail_trim_law.h" 
+#include "trim_batch.h" 
+
+#define BENCH_SAMPLES (1L << 20) 
+#define BENCH_REPEATS 20 
+
+static double now(void);
+static int checkAllReadings(void);
+static int checkTicks(const int *, int *, long);
+
+// checks trimBatch against the firmware functions for every ADC reading and trimBatchTicks against the firmware frame by frame,
+// then reports samples per second for each
+int main(void) {
+    int *RAW = malloc(BENCH_SAMPLES * sizeof(int));
+    int *PULSE = malloc(BENCH_SAMPLES * sizeof(int));
+    long i;
+    int r;
+    double START, SCALAR_TIME, BATCH_TIME, TICKS_TIME;
+    long CHECKSUM = 0;
+
+    if (!RAW || !PULSE){
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    if (checkAllReadings()){
+        return 1;
+    }
+
+    srand(1);
+    for (i = 0; i < BENCH_SAMPLES; i++){
+        RAW[i] = rand() & 0x3FF;
+    }
+    if (checkTicks(RAW, PULSE, BENCH_SAMPLES)){
+        return 1;
+    }
+
+    START = now();
+    for (r = 0; r < BENCH_REPEATS; r++){
+        for (i = 0; i < BENCH_SAMPLES; i++){
+            PULSE[i] = calcSailPosition(calcAppWind(RAW[i]));
+        }
+        CHECKSUM += PULSE[r];
+    }
+    SCALAR_TIME = now() - START;
+
+    START = now();
+    for (r = 0; r < BENCH_REPEATS; r++){
+        trimBatch(RAW, PULSE, BENCH_SAMPLES);
+        CHECKSUM += PULSE[r];
+    }
+    BATCH_TIME = now() - START;
+
+    START = now();
+    for (r = 0; r < BENCH_REPEATS; r++){
+        trimBatchTicks(RAW, PULSE, BENCH_SAMPLES);
+        CHECKSUM += PULSE[r];
+    }
+    TICKS_TIME = now() - START;
+
+    printf("scalar: %.1f Msamples/s\n", BENCH_SAMPLES * BENCH_REPEATS / SCALAR_TIME / 1e6);
+    printf("batch:  %.1f Msamples/s\n", BENCH_SAMPLES * BENCH_REPEATS / BATCH_TIME / 1e6);
+    printf("ticks:  %.1f Msamples/s\n", BENCH_SAMPLES * BENCH_REPEATS / TICKS_TIME / 1e6);
+    printf("checksum %ld\n", CHECKSUM);
+
+    free(RAW);
+    free(PULSE);
+    return 0;
+}
+
+static double now(void) {
+    struct timespec T;
+    clock_gettime(CLOCK_MONOTONIC, &T);
+    return T.tv_sec + T.tv_nsec / 1e9;
+}
+
+// the ADC reading is 10 bits, so every possible input can be compared
+static int checkAllReadings(void) {
+    int RAW[0x400];
+    int PULSE[0x400];
+    int i;
+
+    for (i = 0; i <= 0x3FF; i++){
+        RAW[i] = i;
+    }
+    trimBatch(RAW, PULSE, 0x400);
+    for (i = 0; i <= 0x3FF; i++){
+        int EXPECTED = calcSailPosition(calcAppWind(i));
+        if (PULSE[i] != EXPECTED){
+            fprintf(stderr, "mismatch at reading 0x%X: batch %d, firmware %d\n", i, PULSE[i], EXPECTED);
+            return 1;
+        }
+    }
+    printf("all 1024 readings match the firmware\n");
+    return 0;
+}
+
+// the dithered counts depend on the order of the readings, so the whole sequence is compared with the firmware running one frame per reading
+// trimBatchTicks is called in uneven chunks to check the dither error carries over between calls
+static int checkTicks(const int *RAW, int *TICKS, long N) {
+    long i, START;
+    int END_ERROR;
+
+    ditherError = 0;
+    for (START = 0; START < N; START += 1000){
+        trimBatchTicks(RAW + START, TICKS + START, (N - START < 1000) ? N - START : 1000);
+    }
+    END_ERROR = ditherError;
+    ditherError = 0;
+    for (i = 0; i < N; i++){
+        int EXPECTED = ditherPulse(calcSailPosition(calcAppWind(RAW[i])));
+        if (TICKS[i] != EXPECTED){
+            fprintf(stderr, "mismatch at sample %ld: batch %d, firmware %d\n", i, TICKS[i], EXPECTED);
+            return 1;
+        }
+    }
+    if (END_ERROR != ditherError){
+        fprintf(stderr, "dither error after batch %d, firmware %d\n", END_ERROR, ditherError);
+        return 1;
+    }
+    printf("%ld dithered TA0CCR1 counts match the firmware\n", N);
+    return 0;
+}